@@ -18,6 +18,13 @@
 #include "action.h"
 #include <fstream>
 #include <time.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <omp.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 class agent {
 public:
@@ -34,6 +41,10 @@ public:
 	virtual void close_episode(const std::string& flag = "") {}
 	virtual action take_action(const board& b) { return action(); }
 	virtual bool check_for_win(const board& b) { return false; }
+	virtual void start_pondering(const board& b) {}
+	virtual void stop_pondering() {}
+	virtual void time_settings(double main_time, double byo_yomi_time, int byo_yomi_stones) {}
+	virtual void time_left(double time, int stones) {}
 
 public:
 	virtual std::string property(const std::string& key) const { return meta.at(key); }
@@ -52,6 +63,71 @@ protected:
 	std::map<key, value> meta;
 };
 
+/**
+ * xoshiro256** pseudo-random generator, whose state is filled by splitmix64 from the seed
+ * it works as a UniformRandomBitGenerator, and bounded draws unbiased integers without division
+ */
+class xoshiro256 {
+public:
+	typedef uint64_t result_type;
+	xoshiro256(uint64_t seed = 1) { this->seed(seed); }
+
+	void seed(uint64_t seed) {
+		for (uint64_t& x : s) {
+			uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+			x = z ^ (z >> 31);
+		}
+	}
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return ~result_type(0); }
+
+	result_type operator()() {
+		uint64_t result = rotl(s[1] * 5, 7) * 9, t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+
+	/**
+	 * a uniform integer in [0, n) for n > 0, by multiplying and rejecting the biased low products (Lemire)
+	 */
+	uint32_t bounded(uint32_t n) {
+		uint64_t m = uint64_t(operator()() >> 32) * n;
+		if (uint32_t(m) < n) {
+			uint32_t threshold = uint32_t(-n) % n;
+			while (uint32_t(m) < threshold) m = uint64_t(operator()() >> 32) * n;
+		}
+		return uint32_t(m >> 32);
+	}
+
+	/**
+	 * advance the state by 2^128 draws, so that the generators jumped different times never overlap
+	 */
+	void jump() {
+		static const uint64_t poly[] = { 0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull, 0x39abdc4529b1661cull };
+		uint64_t t[4] = {};
+		for (uint64_t p : poly) {
+			for (int b = 0; b < 64; b++) {
+				if (p & (uint64_t(1) << b)) {
+					for (int k = 0; k < 4; k++) t[k] ^= s[k];
+				}
+				operator()();
+			}
+		}
+		for (int k = 0; k < 4; k++) s[k] = t[k];
+	}
+
+private:
+	static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+	uint64_t s[4];
+};
+
 /**
  * base agent for agents with randomness
  */
@@ -59,12 +135,12 @@ class random_agent : public agent {
 public:
 	random_agent(const std::string& args = "") : agent(args) {
 		if (meta.find("seed") != meta.end())
-			engine.seed(int(meta["seed"]));
+			engine.seed(uint64_t(meta["seed"]));
 	}
 	virtual ~random_agent() {}
 
 protected:
-	std::default_random_engine engine;
+	xoshiro256 engine;
 };
 
 /**
@@ -88,13 +164,9 @@ public:
 
 	virtual action take_action(const board& state) {
 		//std::cout<<"random state:"<<state<<std::endl;
-		std::shuffle(space.begin(), space.end(), engine);
-		for (const action::place& move : space) {
-			board after = state;
-			if (move.apply(after) == board::legal)
-				return move;
-		}
-		return action();
+		board::mask legal = state.legal_moves(who);
+		if (legal == 0) return action();
+		return space[board::nth(legal, engine.bounded(board::popcount(legal)))];
 	}
 
 private:
@@ -102,26 +174,432 @@ private:
 	board::piece_type who;
 };
 
-class Node
-{
-	public:
-		board state;
+/**
+ * transposition table of the MCTS statistics keyed by board::hash(),
+ * so that the nodes of the same position reached by different move orders share their record
+ * a key probes a few consecutive entries, and the entries not found since the last clear are reused
+ */
+class transposition_table {
+public:
+	struct record {
 		int win_count = 0;
 		int visit_count = 0;
-		double value = std::numeric_limits<float>::max();
-		Node* parent = nullptr;
-		action::place last_action;
-		std::vector<Node*> children;
-		board::piece_type node_who;
+	};
+	static constexpr unsigned none = -1u;
+
+	void resize(unsigned size_log2) {
+		table.assign(size_log2 ? size_t(1) << size_log2 : 0, entry());
+		age = 0;
+	}
+	bool enabled() const { return table.size(); }
+	void clear() { age++; }
+
+	/**
+	 * find the slot of the key, or allocate one for it, where a record not found since the last clear starts anew
+	 * return none if the table is disabled or the probing entries have all been found since the last clear
+	 */
+	unsigned find(uint64_t key) {
+		unsigned free = none;
+		for (size_t i = 0; i < probe && table.size(); i++) {
+			unsigned slot = (key + i) & (table.size() - 1);
+			entry& e = table[slot];
+			if (e.key == key) {
+				if (e.age != age) renew(e, key);
+				return slot;
+			}
+			if (e.age != age && free == none) free = slot;
+		}
+		if (free != none) renew(table[free], key);
+		return free;
+	}
+	record& operator [](unsigned slot) { return table[slot].stats; }
+
+private:
+	struct entry {
+		uint64_t key = 0;
+		unsigned age = -1u;
+		record stats;
+	};
+	void renew(entry& e, uint64_t key) {
+		e = entry();
+		e.key = key;
+		e.age = age;
+	}
+	static constexpr size_t probe = 8;
+	std::vector<entry> table;
+	unsigned age = 0;
+};
+
+/**
+ * arena of the MCTS nodes stored as structure of arrays, where a node is an index of the arrays
+ * the children of a node are reserved as one contiguous block [first, first + count),
+ * so that selection scans dense arrays of their statistics
+ * the block is filled lazily, i.e., only [first, first + expanded) have been created
+ * a node takes 21 bytes since it does not keep a board, which is replayed from the root by its moves
+ * the arrays are kept for later searches, so a search only allocates when it outgrows all previous ones
+ */
+class node_pool {
+public:
+	typedef uint32_t node;
+
+	/**
+	 * reserve a block of n nodes without initializing them, and return the first of them
+	 */
+	node reserve(unsigned n) {
+		if (concurrent) {
+			size_t block = add(used, size_t(n));
+			return block + n <= move.size() ? node(block) : busy;
+		}
+		node block = used;
+		used += n;
+		if (used > move.size()) grow(std::max<size_t>(used, move.size() * 2));
+		return block;
+	}
+	/**
+	 * allocate a block of n nodes with cleared statistics, and return the first of them
+	 */
+	node allocate(unsigned n) {
+		node block = reserve(n);
+		for (node i = block; i < used; i++) clear(i);
+		return block;
+	}
+	void clear(node i) {
+		win_count[i] = 0;
+		visit_count[i] = 0;
+		first[i] = 0;
+		count[i] = 0;
+		claimed[i] = 0;
+		expanded[i] = 0;
+		proven[i] = 0;
+		shared[i] = transposition_table::none;
+		add(created, size_t(1));
+	}
+	void release() { used = created = 0; }
+	/**
+	 * the slots reserved so far, and the nodes created in them, which are fewer since blocks are filled lazily
+	 */
+	size_t size() const { return std::min(load(used), move.size()); }
+	size_t nodes() const { return load(created); }
+
+	/**
+	 * let several threads grow the pool, which is then fixed to at least the given capacity
+	 * reserve returns busy instead of growing the pool when it is full
+	 */
+	void share(size_t capacity) {
+		if (capacity > move.size()) grow(capacity);
+		concurrent = true;
+	}
+	void unshare() {
+		concurrent = false;
+		used = size();
+	}
+	/**
+	 * whether a reservation has failed since the pool was shared, which must be asked before unshare
+	 */
+	bool full() const { return load(used) > move.size(); }
+
+	/**
+	 * atomic accessors for the arrays shared by the threads of a tree-parallel search
+	 * counts are relaxed, while first and expanded publish the children with acquire/release
+	 */
+	template<typename type> static type load(const type& x, int order = __ATOMIC_RELAXED) {
+		type v;
+		__atomic_load(&x, &v, order);
+		return v;
+	}
+	template<typename type> static void store(type& x, type v, int order = __ATOMIC_RELAXED) {
+		__atomic_store(&x, &v, order);
+	}
+	template<typename type> static type add(type& x, type v) {
+		return __atomic_fetch_add(&x, v, __ATOMIC_RELAXED);
+	}
+	template<typename type> static bool exchange(type& x, type& expect, type v) {
+		return __atomic_compare_exchange_n(&x, &expect, v, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+	}
+
+	/**
+	 * copy the subtree of the given node into another pool, and return the copied root there
+	 * only the created children are copied, but the blocks keep their reserved sizes
+	 */
+	node copy(node root, node_pool& into) const {
+		node top = into.reserve(1);
+		into.assign(top, *this, root);
+		std::vector<std::pair<node, node>> queue(1, std::make_pair(root, top));
+		for (size_t k = 0; k < queue.size(); k++) {
+			node from = queue[k].first, to = queue[k].second;
+			node block = first[from] ? into.reserve(count[from]) : 0;
+			into.first[to] = block;
+			for (unsigned i = 0; i < expanded[from]; i++) {
+				into.assign(block + i, *this, first[from] + i);
+				queue.emplace_back(first[from] + i, block + i);
+			}
+		}
+		return top;
+	}
+
+public:
+	std::vector<uint8_t> move; // the point played into the node
+	std::vector<int> win_count; // the wins of the side who has moved into the node
+	std::vector<int> visit_count;
+	std::vector<node> first; // the first child
+	std::vector<uint8_t> count; // the number of children
+	std::vector<uint8_t> claimed; // the number of children being or having been created
+	std::vector<uint8_t> expanded; // the number of children created
+	std::vector<int8_t> proven; // 1 if the side who has moved into the node wins for sure, -1 if it loses for sure, or 0
+	std::vector<unsigned> shared; // the slot in the transposition table, or none
+	static constexpr node busy = -1u; // the first child of a node being expanded, or a failed reservation
+
+private:
+	void assign(node i, const node_pool& from, node j) {
+		move[i] = from.move[j];
+		win_count[i] = from.win_count[j];
+		visit_count[i] = from.visit_count[j];
+		count[i] = from.count[j];
+		claimed[i] = from.expanded[j];
+		expanded[i] = from.expanded[j];
+		proven[i] = from.proven[j];
+		shared[i] = from.shared[j];
+		created++;
+	}
+	void grow(size_t size) {
+		size = std::max<size_t>(size, 4096);
+		move.resize(size);
+		win_count.resize(size);
+		visit_count.resize(size);
+		first.resize(size);
+		count.resize(size);
+		claimed.resize(size);
+		expanded.resize(size);
+		proven.resize(size);
+		shared.resize(size);
+	}
+	size_t used = 0;
+	size_t created = 0;
+	bool concurrent = false;
+};
+
+/**
+ * time management of the searches within the budget of a game
+ * a search is given its share of the remaining time as the target, and may stop before it once the best move is settled,
+ * or go on after it until the limit while the best two moves are close
+ * the budget may be followed by periods of Canadian byo-yomi, where a given number of moves are played in a given time
+ */
+class time_manager {
+public:
+	typedef std::chrono::steady_clock clock;
+
+	/**
+	 * set the time of a game in seconds, which is the main time followed by periods of byo-yomi if period_stones > 0
+	 */
+	void reset(double main_time, double period_time = 0, int period_stones = 0) {
+		remain = main_time;
+		period = period_time;
+		stones = period_stones;
+		stones_left = 0;
+		if (remain <= 0 && stones > 0) next_period();
+	}
+	/**
+	 * set the time left, which is for the rest of the main time if stones == 0, or for the given moves of byo-yomi
+	 */
+	void update(double time, int moves) {
+		remain = time;
+		stones_left = moves;
+	}
+	double remaining() const { return remain; }
+
+	/**
+	 * start a search of the given time regardless of the budget, or without any time limit if seconds <= 0
+	 */
+	void start_fixed(double seconds) {
+		begin = clock::now();
+		until = last = (seconds > 0 ? begin + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds)) : clock::time_point::max());
+		fixed = true;
+	}
+
+	/**
+	 * start a search, which is expected to be followed by the given number of our moves including itself
+	 * in byo-yomi, the moves left in the period are taken instead, and a reserve is always kept for the communication
+	 * in the main time, at least least_moves are expected, since a few legal moves do not mean the game ends soon
+	 */
+	void start(int moves_left) {
+		moves_left = (stones_left > 0 ? stones_left : std::max(moves_left, least_moves));
+		double usable = std::max(remain - reserve, 0.0), share = usable / moves_left;
+		double target = std::max(share, minimum), limit = std::max(std::min(share * extension, moves_left > 1 ? usable / 2 : usable), target);
+		begin = clock::now();
+		until = begin + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(target));
+		last = begin + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(limit));
+		fixed = false;
+	}
+
+	/**
+	 * whether to go on searching at the given time, with the two most visited root children and the iterations so far
+	 * the search stops early when the runner-up cannot catch up by the target even if it takes all the iterations left,
+	 * and is extended after the target while the runner-up has at least 80% of the visits of the best
+	 */
+	bool proceed(clock::time_point now, int best, int second, int iterations) const {
+		if (now >= last) return false;
+		if (fixed) return true;
+		double elapsed = std::chrono::duration<double>(now - begin).count();
+		double rate = (elapsed > 0 ? iterations / elapsed : 0);
+		if (now < until)
+			return rate == 0 || best - second <= rate * std::chrono::duration<double>(until - now).count();
+		return second * 5 >= best * 4 && best - second <= rate * std::chrono::duration<double>(last - now).count();
+	}
+
+	/**
+	 * the time when the search is expected to stop, see start
+	 */
+	clock::time_point target() const { return until; }
+	/**
+	 * the time when any search must stop
+	 */
+	clock::time_point deadline() const { return last; }
+
+	/**
+	 * charge the time taken since the search started to the budget, and start a new period of byo-yomi when due
+	 */
+	void stop() {
+		remain -= std::chrono::duration<double>(clock::now() - begin).count();
+		if (stones_left > 0 ? --stones_left == 0 : (remain <= 0 && stones > 0)) next_period();
+	}
+
+private:
+	void next_period() {
+		remain = period;
+		stones_left = stones;
+	}
+
+	double remain = 0;
+	double period = 0;
+	int stones = 0; // the moves of a period, or 0 without byo-yomi
+	int stones_left = 0; // the moves left in the current period, or 0 in the main time
+	clock::time_point begin, until, last;
+	bool fixed = false;
+	double minimum = 0.01; // the least target of a search, in seconds
+	double extension = 2.5; // the limit of a search, relative to its share
+	double reserve = 0.05; // the time kept for the communication, in seconds
+	int least_moves = 8; // the least moves expected to be left in the main time
+};
+
+/**
+ * exact solver of the endgame, where a position is either won or lost by the side to move
+ * it is a negamax search with alpha-beta pruning, which stops at the first winning move since there are only two values,
+ * and the results are kept in a transposition table keyed by board::hash() for all later searches
+ * the moves that also take a point from the opponent are tried first, then those next to opponent blocks of fewer liberties
+ */
+class endgame_solver {
+public:
+	typedef std::chrono::steady_clock clock;
+	static constexpr int lost = -1;
+	static constexpr int unknown = -2;
+
+	/**
+	 * find a winning move of who, who is the side to move, within the given time and the given positions
+	 * return the point of a winning move, lost if every move loses, or unknown if the search is aborted at either limit
+	 */
+	int solve(const board& state, unsigned who, clock::time_point deadline, size_t positions) {
+		if (table.empty()) table.resize(size_t(1) << size_log2);
+		until = deadline;
+		budget = positions;
+		searched = 0;
+		aborted = false;
+		board::piece_type opp = (who == board::black ? board::white : board::black);
+		unsigned moves[board::size_x * board::size_y], n = order(state, who, moves);
+		for (unsigned k = 0; k < n; k++) {
+			board after = state;
+			after.play(moves[k], who);
+			bool win = !wins(after, opp);
+			if (aborted) return unknown;
+			if (win) return moves[k];
+		}
+		return lost;
+	}
+	/**
+	 * the positions searched by the last solve, where those found in the table are not counted
+	 */
+	size_t visited() const { return searched; }
+
+private:
+	/**
+	 * whether who, who is the side to move of the state, wins, which is meaningless once aborted
+	 */
+	bool wins(const board& state, unsigned who) {
+		if (!state.legal_moves(who)) return false;
+		uint64_t key = state.hash();
+		entry& e = table[key & (table.size() - 1)];
+		if (e.key == key && e.result) return e.result > 0;
+		if (++searched > budget || (searched % check_interval == 0 && clock::now() >= until)) aborted = true;
+		if (aborted) return false;
+
+		board::piece_type opp = (who == board::black ? board::white : board::black);
+		unsigned moves[board::size_x * board::size_y], n = order(state, who, moves);
+		bool win = false;
+		for (unsigned k = 0; k < n && !win && !aborted; k++) {
+			board after = state;
+			after.play(moves[k], who);
+			win = !wins(after, opp);
+		}
+		if (aborted) return false;
+		e.key = key;
+		e.result = win ? 1 : -1;
+		return win;
+	}
 
-		~Node(){}
+	/**
+	 * store the legal moves of who into moves in the order to be tried, and return how many there are
+	 */
+	static unsigned order(const board& state, unsigned who, unsigned* moves) {
+		board::mask opp_stones = state.stones(3u - who), shared = state.legal_moves(3u - who);
+		uint16_t keys[board::size_x * board::size_y];
+		unsigned n = 0;
+		for (board::mask m = state.legal_moves(who); m; m &= m - 1) {
+			unsigned i = board::lowest(m), pressure = 63;
+			for (board::mask near = board::neighbors(board::bit(i)) & opp_stones; near; near &= near - 1)
+				pressure = std::min(pressure, state.liberty(board::lowest(near)));
+			keys[n++] = ((((shared & board::bit(i)) ? 0 : 64) + pressure) << 8) | i;
+		}
+		std::sort(keys, keys + n);
+		for (unsigned k = 0; k < n; k++) moves[k] = keys[k] & 0xff;
+		return n;
+	}
+
+	struct entry {
+		uint64_t key = 0;
+		int8_t result = 0; // 1 if the side to move wins, -1 if it loses, or 0 if unused
+	};
+	static constexpr unsigned size_log2 = 20;
+	static constexpr size_t check_interval = 1024; // the positions between two reads of the clock
+	std::vector<entry> table;
+	clock::time_point until;
+	size_t budget = 0;
+	size_t searched = 0;
+	bool aborted = false;
 };
 
 class MCTS_player : public random_agent {
 public:
+	// the search tree, which is grown by one worker, or by all of them in tree-parallel search
+	// in leaf-parallel search, only the first worker grows it, and the others help with its playouts
+	struct search_tree {
+		node_pool pool;
+		node_pool spare;
+		transposition_table table;
+		int root_visits = 0; // the visits of the root when the search started, taken before any worker starts
+	};
+	// the search state of a thread
+	struct worker {
+		search_tree* tree = nullptr;
+		std::vector<node_pool::node> path;
+		size_t path_depth = 0;
+		int virtual_loss = 0;
+		xoshiro256 engine;
+		node_pool::node root = 0; // the root of the current search
+		int check_interval = 1; // the iterations between two reads of the clock
+		int since_check = 0;
+		std::chrono::steady_clock::time_point last_check;
+	};
+
 	MCTS_player(const std::string& args = "") : random_agent("name=random role=unknown " + args),
-		white_space(board::size_x * board::size_y),
-		black_space(board::size_x * board::size_y), 
 		who(board::empty) {
 
 		if (name().find_first_of("[]():; ") != std::string::npos)
@@ -130,190 +608,700 @@ public:
 		if (role() == "white") who = board::white;
 		if (who == board::empty)
 			throw std::invalid_argument("invalid role: " + role());
-		for (size_t i = 0; i < white_space.size(); i++)
-			white_space[i] = action::place(i, board::white);
-		for (size_t i = 0; i < black_space.size(); i++)
-			black_space[i] = action::place(i, board::black);
-	}
-
-	// value = win_count / visit_vount + 1.41 * UCB
-	void compute_value(Node* node, int total_visit_count){
-		node->value = ((double)node->win_count/node->visit_count) + 0.5 * sqrt(log((double)total_visit_count)/node->visit_count);
-	}
-
-	Node* select(Node* node){
-		//std::cout<<"node_children size: "<<node->children.size()<<std::endl;
-		while(node->children.empty() == false){
-			double max_value = 0;
-			int select_index = 0; 
-			for(size_t i=0; i < node->children.size(); i++){
-				if (max_value < node->children[i]->value){
-					max_value = node->children[i]->value;
-					select_index = i;
+		if (meta.find("threads") != meta.end())
+			workers.resize(std::max(int(meta["threads"]), 1));
+		if (meta.find("parallel") != meta.end()){
+			if (property("parallel") != "root" && property("parallel") != "tree" && property("parallel") != "leaf")
+				throw std::invalid_argument("invalid parallel: " + property("parallel"));
+			trees.resize(property("parallel") == "root" ? workers.size() : 1);
+			leaf_parallel = (property("parallel") == "leaf");
+		} else {
+			trees.resize(workers.size());
+		}
+		// a leaf-parallel search runs a playout per thread by default, since the other threads would idle
+		if (meta.find("playouts") != meta.end())
+			playouts = std::max(int(meta["playouts"]), 1);
+		else if (leaf_parallel == true)
+			playouts = workers.size();
+		if (meta.find("expand") != meta.end())
+			expand_threshold = std::max(int(meta["expand"]), 0);
+		int virtual_loss = 1;
+		if (meta.find("vloss") != meta.end())
+			virtual_loss = std::max(int(meta["vloss"]), 0);
+		// the workers take disjoint streams of the engine, so a seeded search is reproducible per worker
+		xoshiro256 stream = engine;
+		for(size_t k = 0; k < workers.size(); k++){
+			workers[k].tree = &trees[k % trees.size()];
+			workers[k].virtual_loss = (shared_tree() ? virtual_loss : 0);
+			stream.jump();
+			workers[k].engine = stream;
+		}
+		// tt= is the log2 of the table entries, and works with reuse=, since the reused records are found again
+		// the table is not thread-safe, so a shared tree goes without it
+		if (meta.find("tt") != meta.end() && shared_tree() == false){
+			for (search_tree& t : trees)
+				t.table.resize(int(meta["tt"]));
+		}
+		if (meta.find("reuse") != meta.end())
+			reuse = int(meta["reuse"]);
+		if (meta.find("ponder") != meta.end())
+			ponder = int(meta["ponder"]);
+		if (meta.find("budget") != meta.end())
+			budget = double(meta["budget"]);
+		default_budget = budget;
+		if (meta.find("iterations") != meta.end())
+			iteration_limit = int(meta["iterations"]);
+		if (meta.find("nodes") != meta.end())
+			node_limit = size_t(meta["nodes"]);
+		if (meta.find("time") != meta.end())
+			time_limit = double(meta["time"]) / 1000;
+		if (meta.find("report") != meta.end())
+			report = int(meta["report"]);
+		if (meta.find("solve") != meta.end())
+			solve_threshold = int(meta["solve"]);
+		if (meta.find("solve_nodes") != meta.end())
+			solve_nodes = size_t(meta["solve_nodes"]);
+		timer.reset(budget, period_time, period_stones);
+	}
+	virtual ~MCTS_player(){
+		stop_pondering();
+	}
+
+	virtual void open_episode(const std::string& flag = ""){
+		last_move = -1;
+		timer.reset(budget, period_time, period_stones);
+	}
+
+	// the time settings of GTP, which last until they are set again
+	// zero stones with a positive byo-yomi time means no time limit whatever the main time is, where budget= is restored
+	virtual void time_settings(double main_time, double byo_yomi_time, int byo_yomi_stones){
+		bool unlimited = (byo_yomi_time > 0 && byo_yomi_stones == 0);
+		budget = (unlimited ? default_budget : main_time);
+		period_time = (unlimited ? 0 : byo_yomi_time);
+		period_stones = (unlimited ? 0 : byo_yomi_stones);
+		timer.reset(budget, period_time, period_stones);
+	}
+	virtual void time_left(double time, int stones){
+		timer.update(time, stones);
+	}
+
+	// whether several workers grow the same tree
+	bool shared_tree() const{
+		return trees.size() < workers.size() && leaf_parallel == false;
+	}
+
+	// the pool of a shared tree cannot grow while the workers reserve in it, so it is sized before the search
+	// by the slots the search may take, which are at most a block of children per iteration or per node if either is fixed,
+	// or else estimated from the time until the deadline at twice the rate of the last shared search
+	size_t shared_capacity(){
+		size_t need = pool_limit;
+		if (iteration_limit > 0)
+			need = std::min(need, size_t(iteration_limit) * board::size_x * board::size_y);
+		if (node_limit > 0)
+			need = std::min(need, node_limit * board::size_x * board::size_y);
+		if (timer.deadline() != std::chrono::steady_clock::time_point::max()){
+			double seconds = std::chrono::duration<double>(timer.deadline() - std::chrono::steady_clock::now()).count();
+			need = std::min(need, size_t(std::max(seconds, 0.0) * slot_rate * 2) + 4096);
+		}
+		size_t capacity = trees[0].pool.size() + need;
+		return capacity < pool_limit ? capacity : pool_limit;
+	}
+
+	// sqrt(log(n)) and 1 / sqrt(n) of small visit counts, which are looked up instead of computed in select
+	struct ucb_table {
+		static constexpr int size = 4096;
+		float sqrt_log[size], inv_sqrt[size];
+		ucb_table(){
+			sqrt_log[0] = inv_sqrt[0] = 0;
+			for(int n = 1; n < size; n++){
+				sqrt_log[n] = sqrt(log((double)n));
+				inv_sqrt[n] = 1 / sqrt((double)n);
+			}
+		}
+	};
+	static const ucb_table& ucb(){
+		static const ucb_table table;
+		return table;
+	}
+
+	// value = win_count / visit_count + 0.5 * sqrt(log(parent_visit_count) / visit_count), by the side who moves into the child
+	// a child without visits is taken first
+	static float compute_value(int win_count, int visit_count, float parent_sqrt_log){
+		if (visit_count <= 0)
+			return std::numeric_limits<float>::max();
+		float inv_sqrt = (visit_count < ucb_table::size ? ucb().inv_sqrt[visit_count] : float(1 / sqrt((double)visit_count)));
+		return float(win_count) / visit_count + 0.5f * parent_sqrt_log * inv_sqrt;
+	}
+
+	// the index of the child of the highest value among the n contiguous children with the given counts
+	// proven children are skipped, and the first child is returned if all of them are proven
+	// the AVX2 version is taken when the CPU supports it, otherwise the scalar one
+	// in tree-parallel search, the counts may be updated meanwhile, which only makes some of them stale
+	static unsigned best_child(const int* win_count, const int* visit_count, const int8_t* proven, unsigned n, float parent_sqrt_log){
+		static unsigned (*const best)(const int*, const int*, const int8_t*, unsigned, float) =
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_cpu_supports("avx2") ? best_child_avx2 :
+#endif
+			best_child_scalar;
+		return best(win_count, visit_count, proven, n, parent_sqrt_log);
+	}
+	static unsigned best_child_scalar(const int* win_count, const int* visit_count, const int8_t* proven, unsigned n, float parent_sqrt_log){
+		float max_value = -std::numeric_limits<float>::max();
+		unsigned best = 0;
+		for(unsigned i = 0; i < n; i++){
+			float value = (proven[i] ? -std::numeric_limits<float>::max() : compute_value(win_count[i], visit_count[i], parent_sqrt_log));
+			if (max_value < value){
+				max_value = value;
+				best = i;
+			}
+		}
+		return best;
+	}
+#if defined(__x86_64__) || defined(__i386__)
+	// eight children at a time, where 1 / n and 1 / sqrt(n) are approximated by rcp and rsqrt (about 12 bits)
+	// the lanes keep their own best, and the earliest child wins a tie as in the scalar version
+	__attribute__((target("avx2"))) static unsigned best_child_avx2(const int* win_count, const int* visit_count, const int8_t* proven, unsigned n, float parent_sqrt_log){
+		const __m256 c = _mm256_set1_ps(0.5f * parent_sqrt_log), unvisited = _mm256_set1_ps(std::numeric_limits<float>::max());
+		const __m256 skipped = _mm256_set1_ps(-std::numeric_limits<float>::max());
+		__m256 best_value = skipped;
+		__m256i best_index = _mm256_setzero_si256(), index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		unsigned i = 0;
+		for(; i + 8 <= n; i += 8){
+			__m256 visits = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(visit_count + i)));
+			__m256 wins = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(win_count + i)));
+			__m256 value = _mm256_add_ps(_mm256_mul_ps(wins, _mm256_rcp_ps(visits)), _mm256_mul_ps(c, _mm256_rsqrt_ps(visits)));
+			value = _mm256_blendv_ps(value, unvisited, _mm256_cmp_ps(visits, _mm256_setzero_ps(), _CMP_LE_OQ));
+			__m256i proofs = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(proven + i)));
+			value = _mm256_blendv_ps(skipped, value, _mm256_castsi256_ps(_mm256_cmpeq_epi32(proofs, _mm256_setzero_si256())));
+			__m256 greater = _mm256_cmp_ps(value, best_value, _CMP_GT_OQ);
+			best_value = _mm256_blendv_ps(best_value, value, greater);
+			best_index = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(best_index), _mm256_castsi256_ps(index), greater));
+			index = _mm256_add_epi32(index, _mm256_set1_epi32(8));
+		}
+		alignas(32) float values[8];
+		alignas(32) int indices[8];
+		_mm256_store_ps(values, best_value);
+		_mm256_store_si256((__m256i*)indices, best_index);
+		float max_value = values[0];
+		unsigned best = indices[0];
+		for(unsigned k = 1; k < 8; k++){
+			if (max_value < values[k] || (max_value == values[k] && unsigned(indices[k]) < best)){
+				max_value = values[k];
+				best = indices[k];
+			}
+		}
+		for(; i < n; i++){
+			float value = (proven[i] ? -std::numeric_limits<float>::max() : compute_value(win_count[i], visit_count[i], parent_sqrt_log));
+			if (max_value < value){
+				max_value = value;
+				best = i;
+			}
+		}
+		return best;
+	}
+#endif
+
+	// the side who has just moved into the node at the given depth, where the root is at depth 0
+	board::piece_type node_who(size_t depth){
+		return (depth % 2 == 1) ? who : (who == board::white ? board::black : board::white);
+	}
+
+	// records shared through the transposition table may be updated by other paths, so refresh them first
+	// the state is advanced from the given node, which is at the given depth, to the selected one
+	// unvisited children are created one at a time, and are selected before any other child
+	// a node whose children are still being published by another worker, or whose result is proven, is treated as a leaf
+	node_pool::node select(worker& w, node_pool::node node, size_t depth, board& state){
+		node_pool& pool = w.tree->pool;
+		w.path.assign(1, node);
+		w.path_depth = depth;
+		while(node_pool::load(pool.proven[node]) == 0){
+			node_pool::node first = node_pool::load(pool.first[node], __ATOMIC_ACQUIRE);
+			if (first == 0 || first == node_pool::busy || pool.count[node] == 0)
+				break;
+			node_pool::node child = node_pool::busy;
+			if (node_pool::load(pool.claimed[node]) < pool.count[node])
+				child = create_child(w, node, node_who(w.path_depth + w.path.size()), state);
+			bool created = (child != node_pool::busy);
+			if (created == false){
+				node_pool::node last = first + node_pool::load(pool.expanded[node], __ATOMIC_ACQUIRE);
+				if (last == first)
+					break;
+				if (w.tree->table.enabled()){
+					for(node_pool::node i = first; i < last; i++)
+						refresh_record(w, i);
 				}
+				int parent_visit_count = std::max(node_pool::load(pool.visit_count[node]), 1);
+				float parent_sqrt_log = (parent_visit_count < ucb_table::size ? ucb().sqrt_log[parent_visit_count] : float(sqrt(log((double)parent_visit_count))));
+				child = first + best_child(&pool.win_count[first], &pool.visit_count[first], &pool.proven[first], last - first, parent_sqrt_log);
 			}
-			node = node->children[select_index];
+			node = child;
+			w.path.push_back(node);
+			add_virtual_loss(w, node);
+			state.place(board::point(pool.move[node]), node_who(w.path_depth + w.path.size() - 1));
+			if (created == true)
+				break;
 		}
 		return node;
 	}
 
-	void expand(Node* parent_node){
+	// count a visit in progress as a loss, so that other workers of a shared tree prefer other paths
+	// backpropogation takes it back when the result of the visit is known
+	void add_virtual_loss(worker& w, node_pool::node node){
+		if (w.virtual_loss != 0)
+			node_pool::add(w.tree->pool.visit_count[node], w.virtual_loss);
+	}
+
+	// only reserve a block for the children, which are created by create_child when they are selected
+	// a leaf is only expanded once it has been visited the given times, since most leaves are never visited again,
+	// and their blocks would be mostly left empty
+	// the worker marking the node as busy publishes the block, or leaves the node unexpanded if the pool is full
+	// a node without children is a proven win for the side who has moved into it, since the other side cannot move
+	void expand(worker& w, node_pool::node parent_node, board::piece_type parent_who, const board& state, int threshold = 0){
+		node_pool& pool = w.tree->pool;
 		board::piece_type child_who;
-		action::place child_move;
-		child_who = (parent_node->node_who == board::black ? board::white : board::black);
-		if (parent_node->node_who == board::black){
-			child_who = board::white;
-			for (const action::place& child_move : white_space){
-				board after = parent_node->state;
-				if (child_move.apply(after) == board::legal){
-					Node* child_node = new Node;
-					child_node->node_who = child_who;
-					child_node->state = after;
-					child_node->parent = parent_node;
-					child_node->last_action = child_move;
-					parent_node->children.push_back(child_node);
-				}
+		child_who = (parent_who == board::black ? board::white : board::black);
+		unsigned count = board::popcount(state.legal_moves(child_who));
+		if (count != 0 && node_pool::load(pool.visit_count[parent_node]) < threshold)
+			return;
+		node_pool::node first = 0;
+		if (node_pool::exchange(pool.first[parent_node], first, node_pool::busy) == false)
+			return;
+		first = pool.reserve(count);
+		pool.count[parent_node] = count;
+		if (count == 0)
+			node_pool::store(pool.proven[parent_node], int8_t(1));
+		node_pool::store(pool.first[parent_node], first == node_pool::busy ? node_pool::node(0) : first, __ATOMIC_RELEASE);
+	}
+
+	// create the next child with a random move among the legal moves that have no child yet
+	// workers claim the children in order, and each child is published after those before it
+	// return busy if all children have been claimed
+	node_pool::node create_child(worker& w, node_pool::node parent_node, board::piece_type child_who, const board& state){
+		node_pool& pool = w.tree->pool;
+		uint8_t index = node_pool::load(pool.claimed[parent_node]);
+		do {
+			if (index >= pool.count[parent_node])
+				return node_pool::busy;
+		} while(node_pool::exchange(pool.claimed[parent_node], index, uint8_t(index + 1)) == false);
+		while(node_pool::load(pool.expanded[parent_node], __ATOMIC_ACQUIRE) != index)
+			std::this_thread::yield();
+		node_pool::node first = pool.first[parent_node], child_node = first + index;
+		board::mask untried = state.legal_moves(child_who);
+		for (node_pool::node i = first; i < child_node; i++)
+			untried &= ~board::bit(pool.move[i]);
+		pool.clear(child_node);
+		pool.move[child_node] = board::nth(untried, w.engine.bounded(board::popcount(untried)));
+		share_record(w, child_node, state.hash(pool.move[child_node], child_who));
+		node_pool::store(pool.expanded[parent_node], uint8_t(index + 1), __ATOMIC_RELEASE);
+		return child_node;
+	}
+	// simulation: play random legal moves on the state until the side to move has none
+	// the moves are drawn from the legal sets of the board, so they are played in place without any check
+	board::piece_type simulation(worker& w, board& state, board::piece_type node_who){
+		board::piece_type who = node_who;
+		while(true){
+			who = (who == board::white ? board::black : board::white);
+			board::mask legal = state.legal_moves(who);
+			if (legal == 0)
+				break;
+			state.play(board::nth(legal, w.engine.bounded(board::popcount(legal))), who);
+		}
+		return (who == board::white ? board::black : board::white);
+	}
+
+	// run the given number of playouts from the leaf, and return how many of them are won by the root player
+	// in leaf-parallel search, the playouts are spread over the threads of all workers, unless there is only one
+	int playout(worker& w, const board& state, board::piece_type node_who){
+		int wins = 0;
+		if (leaf_parallel == true && playouts > 1){
+			#pragma omp parallel for num_threads(workers.size()) reduction(+:wins)
+			for(int k = 0; k < playouts; k++){
+				board after = state;
+				wins += (simulation(workers[omp_get_thread_num()], after, node_who) == who);
+			}
+		} else {
+			for(int k = 0; k < playouts; k++){
+				board after = state;
+				wins += (simulation(w, after, node_who) == who);
 			}
 		}
-		else if(parent_node->node_who == board::white){
-			child_who = board::black;
-			for (const action::place& child_move : black_space){
-				board after = parent_node->state;
-				if (child_move.apply(after) == board::legal){
-					Node* child_node = new Node;
-					child_node->node_who = child_who;
-					child_node->state = after;
-					child_node->parent = parent_node;
-					child_node->last_action = child_move;
-					parent_node->children.push_back(child_node);
-				}
+		return wins;
+	}
+
+	void share_record(worker& w, node_pool::node node, uint64_t key){
+		w.tree->pool.shared[node] = w.tree->table.find(key);
+	}
+
+	// find the records of the subtree again after the table is cleared, where node is reached by state
+	// a record holds the visits of all nodes sharing it, so one with fewer visits than the node has been taken meanwhile,
+	// and is restored from the node
+	void reshare_records(worker& w, node_pool::node node, size_t depth, const board& state){
+		node_pool& pool = w.tree->pool;
+		if (depth == 0)
+			reshare_record(w, node, state.hash());
+		board::piece_type child_who = node_who(depth + 1);
+		for(node_pool::node i = pool.first[node]; i < pool.first[node] + pool.expanded[node]; i++){
+			reshare_record(w, i, state.hash(pool.move[i], child_who));
+			if (pool.expanded[i] != 0){
+				board after = state;
+				after.play(pool.move[i], child_who);
+				reshare_records(w, i, depth + 1, after);
 			}
 		}
 	}
-	// simulation
-	board::piece_type simulation(Node* node){
-		bool finish = false;
-		board state = node->state;
-		//std::cout<<state<<std::endl;
-		//int i ;
-		//std::cin>>i;
-		board::piece_type who = node->node_who;
-		while(finish == false){
-			//std::cout<<state<<std::endl;
-			//std::cin>>i;
-			who = (who == board::white ? board::black : board::white);
-			finish = true;
-			if (who == board::black){
-				std::shuffle(black_space.begin(), black_space.end(), engine);
-				for (const action::place& move : black_space) {
-					board after = state;
-					if (move.apply(after) == board::legal){
-						move.apply(state);
-						finish = false;
-						break;
-					}
-				}
+	void reshare_record(worker& w, node_pool::node node, uint64_t key){
+		node_pool& pool = w.tree->pool;
+		share_record(w, node, key);
+		if (pool.shared[node] == transposition_table::none)
+			return;
+		transposition_table::record& stats = w.tree->table[pool.shared[node]];
+		if (stats.visit_count < pool.visit_count[node]){
+			stats.win_count = pool.win_count[node];
+			stats.visit_count = pool.visit_count[node];
+		}
+	}
+
+	void refresh_record(worker& w, node_pool::node node){
+		node_pool& pool = w.tree->pool;
+		if (pool.shared[node] == transposition_table::none)
+			return;
+		const transposition_table::record& stats = w.tree->table[pool.shared[node]];
+		pool.win_count[node] = stats.win_count;
+		pool.visit_count[node] = stats.visit_count;
+	}
+
+	// update the nodes along the path of the last selection with the results of its playouts,
+	// where wins are those of the root player, and are counted for the side who moves into each node
+	// the first node of the path carries no virtual loss
+	void backpropogation(worker& w, int root_wins, int games){
+		node_pool& pool = w.tree->pool;
+		for(size_t k = 0; k < w.path.size(); k++){
+			node_pool::node node = w.path[k];
+			int wins = (node_who(w.path_depth + k) == who ? root_wins : games - root_wins);
+			if (pool.shared[node] != transposition_table::none){
+				transposition_table::record& stats = w.tree->table[pool.shared[node]];
+				stats.visit_count = stats.visit_count + games;
+				stats.win_count = stats.win_count + wins;
+				pool.win_count[node] = stats.win_count;
+				pool.visit_count[node] = stats.visit_count;
+			} else {
+				node_pool::add(pool.visit_count[node], k == 0 ? games : games - w.virtual_loss);
+				if (wins != 0)
+					node_pool::add(pool.win_count[node], wins);
 			}
-			else if (who == board::white){
-				std::shuffle(white_space.begin(), white_space.end(), engine);
-				for (const action::place& move : white_space) {
-					board after = state;
-					if (move.apply(after) == board::legal){
-						move.apply(state);
-						finish = false;
-						break;
-					}
+		}
+	}
+
+	node_pool::node find_child(const node_pool& pool, node_pool::node node, int move){
+		for(node_pool::node i = pool.first[node]; i < pool.first[node] + pool.expanded[node]; i++){
+			if (pool.move[i] == move)
+				return i;
+		}
+		return -1u;
+	}
+
+	// start from the subtree of the last search if the state follows our last move and one reply of the opponent
+	// the subtree is compacted into the spare pool, which then takes the place of the current one
+	bool reuse_tree(worker& w, const board& state, node_pool::node& root){
+		node_pool& pool = w.tree->pool;
+		if (reuse == true && last_move != -1){
+			board::piece_type opp = (who == board::white ? board::black : board::white);
+			board after = last_state;
+			after.place(board::point(last_move), who);
+			board::mask reply = state.stones(opp) & ~after.stones(opp);
+			if (board::popcount(reply) == 1 && after.place(board::point(board::lowest(reply)), opp) == board::legal && after == state){
+				node_pool::node node = find_child(pool, last_root, last_move);
+				if (node != -1u)
+					node = find_child(pool, node, board::lowest(reply));
+				if (node != -1u){
+					w.tree->spare.release();
+					root = pool.copy(node, w.tree->spare);
+					std::swap(pool, w.tree->spare);
+					return true;
 				}
 			}
 		}
-		return (who == board::white ? board::black : board::white);
+		return false;
+	}
+
+	// whether the worker should go on searching, where the clock is only read every check_interval iterations
+	// at each read, the timer decides from the visits of the two best root children of the tree of the worker
+	// the interval is recalibrated at each read from the measured speed, so that the reads are about a millisecond apart
+	// and none of them falls far behind the deadline, while it at most doubles per read
+	// a search of fixed work also stops by the iterations of all workers or by the nodes of the tree of the worker
+	// and any search stops once the root is proven
+	bool keep_searching(worker& w){
+		if (node_pool::load(w.tree->pool.proven[w.root]) != 0)
+			return false;
+		if (iteration_limit > 0 && node_pool::add(searched, 1) >= iteration_limit)
+			return false;
+		if (node_limit > 0 && w.tree->pool.nodes() >= node_limit)
+			return false;
+		if (++w.since_check < w.check_interval)
+			return true;
+		const node_pool& pool = w.tree->pool;
+		int best = 0, second = 0;
+		for(node_pool::node i = pool.first[w.root]; i < pool.first[w.root] + node_pool::load(pool.expanded[w.root]); i++){
+			int visit_count = node_pool::load(pool.visit_count[i]);
+			if (visit_count > best){
+				second = best;
+				best = visit_count;
+			} else if (visit_count > second){
+				second = visit_count;
+			}
+		}
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (timer.proceed(now, best, second, node_pool::load(pool.visit_count[w.root]) - w.tree->root_visits) == false)
+			return false;
+		double elapsed = std::chrono::duration<double>(now - w.last_check).count();
+		double remain = std::chrono::duration<double>(timer.deadline() - now).count();
+		double interval = (elapsed > 0 ? w.since_check * std::min(0.001, remain) / elapsed : 2.0 * w.since_check);
+		w.check_interval = std::max(1, int(std::min(interval, 2.0 * w.since_check)));
+		w.since_check = 0;
+		w.last_check = now;
+		return true;
 	}
 
-	void backpropogation(Node* root, Node* node, board::piece_type winner, int total_visit_count){
-		bool win = true;
-		if (winner == root->node_who)
-			win = false;
-		while(node != nullptr){
-			node->visit_count = node->visit_count + 1;
-			if (win == true)
-				node->win_count = node->win_count + 1;
-			compute_value(node, total_visit_count);
-			node = node->parent;
+	// one iteration of selection, expansion, simulation and backpropagation
+	// a proven leaf needs no playout, since its result is known, and its proof is propagated instead
+	void iterate(worker& w, node_pool::node root, size_t depth, const board& state){
+		board after = state;
+		node_pool::node greedy_node = select(w, root, depth, after);
+		board::piece_type greedy_who = node_who(w.path_depth + w.path.size() - 1);
+		expand(w, greedy_node, greedy_who, after, expand_threshold);
+		int8_t proof = node_pool::load(w.tree->pool.proven[greedy_node]);
+		int wins;
+		if (proof != 0){
+			wins = ((greedy_who == who) == (proof > 0) ? playouts : 0);
+			prove(w);
+		} else {
+			wins = playout(w, after, greedy_who);
 		}
+		backpropogation(w, wins, playouts);
 	}
 
-	void delete_tree(Node* node){
-		if(node->children.empty() == false){
-			for(size_t i = 0; i < node->children.size(); i++){
-				delete_tree(node->children[i]);
-				if (node->children[i] != nullptr)
-					free(node->children[i]);	
+	// propagate the proof of the last node of the path to its ancestors (MCTS-Solver)
+	// a node is lost by its mover if any child is won by the opponent, and won if all children are lost by the opponent
+	void prove(worker& w){
+		node_pool& pool = w.tree->pool;
+		for(size_t k = w.path.size() - 1; k > 0; k--){
+			node_pool::node parent = w.path[k - 1];
+			int8_t proof = node_pool::load(pool.proven[w.path[k]]);
+			if (proof > 0){
+				node_pool::store(pool.proven[parent], int8_t(-1));
+				continue;
 			}
-			node->children.clear();
+			if (proof == 0 || node_pool::load(pool.expanded[parent], __ATOMIC_ACQUIRE) < pool.count[parent])
+				return;
+			node_pool::node first = pool.first[parent];
+			for(node_pool::node i = first; i < first + pool.count[parent]; i++){
+				if (node_pool::load(pool.proven[i]) >= 0)
+					return;
+			}
+			node_pool::store(pool.proven[parent], int8_t(1));
 		}
 	}
 
-	action greedy_select(Node* node){
+	// keep searching under our last move on the opponent's time, until stop_pondering is called,
+	// the pool reaches its limit, or the position is proven, where any further iteration would only count a visit
+	// the enlarged subtree of the first worker is then picked up by reuse_tree in the next take_action,
+	// so there is no pondering without reuse=, where the subtree would be thrown away
+	virtual void start_pondering(const board& state){
+		if (ponder == false || reuse == false || last_move == -1)
+			return;
+		worker& w = workers[0];
+		board after = last_state;
+		after.place(board::point(last_move), who);
+		node_pool::node node = find_child(w.tree->pool, last_root, last_move);
+		if (node == -1u || !(after == state))
+			return;
+		pondering = true;
+		thinker = std::thread([this, &w, node, after](){
+			expand(w, node, who, after);
+			while(pondering && w.tree->pool.size() < pool_limit && w.tree->pool.proven[node] == 0)
+				iterate(w, node, 1, after);
+		});
+	}
+
+	virtual void stop_pondering(){
+		if (thinker.joinable()){
+			pondering = false;
+			thinker.join();
+		}
+	}
+
+	// choose the move with the most visits, summed over the root children of all trees
+	// a proven win is played at once, and proven losses are only played when all moves are lost,
+	// where a move never tried is taken instead if every tried move is lost
+	action greedy_select(const std::vector<node_pool::node>& roots, const board& state){
+		std::array<int, board::size_x * board::size_y> visit_count = {};
+		board::mask lost = 0, tried = 0;
+		for(size_t k = 0; k < trees.size(); k++){
+			const node_pool& pool = trees[k].pool;
+			for(node_pool::node i = pool.first[roots[k]]; i < pool.first[roots[k]] + pool.expanded[roots[k]]; i++){
+				if (pool.proven[i] > 0)
+					return action::place(pool.move[i], who);
+				if (pool.proven[i] < 0)
+					lost |= board::bit(pool.move[i]);
+				tried |= board::bit(pool.move[i]);
+				visit_count[pool.move[i]] += pool.visit_count[i];
+			}
+		}
+		if (tried & ~lost){
+			for(size_t i = 0; i < visit_count.size(); i++){
+				if (lost & board::bit(i))
+					visit_count[i] = 0;
+			}
+		} else if (board::mask untried = state.legal_moves(who) & ~tried){
+			return action::place(board::nth(untried, engine.bounded(board::popcount(untried))), who);
+		}
 		int child_index = -1;
 		int max_visit_count = 0;
-		for(size_t i = 0; i < node->children.size(); i++){
-			if (node->children[i]->visit_count > max_visit_count){
-				max_visit_count = node->children[i]->visit_count;
+		for(size_t i = 0; i < visit_count.size(); i++){
+			if (visit_count[i] > max_visit_count){
+				max_visit_count = visit_count[i];
 				child_index = i;
 			}
 		}
 		if (child_index == -1)
 			return action();
 		else
-			return node->children[child_index]->last_action;
+			return action::place(child_index, who);
 	}
 	
+	// root-parallel search: each worker grows its own tree on its own thread, where only the first one is reused
+	// tree-parallel search: all workers grow the first tree together, whose pool is fixed in size meanwhile
+	// leaf-parallel search: the first worker grows the only tree, and playout spreads its games over all workers
+	// the time of the search is given by the timer, which expects us to play about half of our legal moves,
+	// unless the search is fixed by any of iterations=, nodes= and time=, where it stops at the first limit reached
+	// a forced move is played at once without any search
+	// when fewer than solve= points are left for either side, the endgame solver is tried first within half of the target
+	// and solve_nodes= positions, so that a search of fixed work is bounded as well,
+	// and its winning move is played at once, while the search goes on if it fails or finds the game lost
 	virtual action take_action(const board& state){
-		clock_t start_time, end_time;
-		start_time = clock();
-		Node* root = new Node;
-		board::piece_type winner;
-		double total_time = 0;
-		int total_visit_count = 0;
-		int remain_empty = 0;
-		for(int i = 0; i < 9; i++){
-			for(int j = 0; j < 9; j++){
-				if(state[i][j] == board::empty)
-					remain_empty++;
+		if (iteration_limit > 0 || node_limit > 0 || time_limit > 0)
+			timer.start_fixed(time_limit);
+		else
+			timer.start(board::popcount(state.legal_moves(who)) / 2);
+		std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+		if (board::popcount(state.legal_moves(who)) == 1){
+			last_move = -1;
+			timer.stop();
+			return action::place(board::lowest(state.legal_moves(who)), who);
+		}
+		if (board::popcount(state.legal_moves(board::black) | state.legal_moves(board::white)) < solve_threshold){
+			std::chrono::steady_clock::time_point until = timer.target();
+			if (until != std::chrono::steady_clock::time_point::max())
+				until = start_time + (until - start_time) / 2;
+			int move = solver.solve(state, who, until, solve_nodes);
+			if (report == true){
+				double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+				std::cerr << name() << ": " << (move >= 0 ? "won" : move == endgame_solver::lost ? "lost" : "unknown") << " by the solver, "
+				          << solver.visited() << " positions, " << elapsed << " s" << std::endl;
+			}
+			if (move >= 0){
+				last_move = -1;
+				timer.stop();
+				return action::place(move, who);
+			}
+		}
+		searched = 0;
+		std::vector<node_pool::node> roots(trees.size());
+
+		for(size_t k = 0; k < trees.size(); k++){
+			worker& w = workers[k];
+			node_pool::node& root = roots[k];
+			// the table is cleared for every search, so the records of a reused subtree are found again
+			bool reused = (k == 0 && reuse_tree(w, state, root));
+			w.tree->table.clear();
+			if (reused == false){
+				w.tree->pool.release();
+				root = w.tree->pool.allocate(1);
+				share_record(w, root, state.hash());
+			} else if (w.tree->table.enabled()){
+				reshare_records(w, root, 0, state);
+			}
+			expand(w, root, node_who(0), state);
+			w.tree->root_visits = w.tree->pool.visit_count[root];
+		}
+		if (shared_tree())
+			trees[0].pool.share(shared_capacity());
+		std::chrono::steady_clock::time_point search_time = std::chrono::steady_clock::now();
+		size_t reserved = trees[0].pool.size();
+
+		size_t searching = (leaf_parallel ? 1 : workers.size());
+		#pragma omp parallel for num_threads(searching) schedule(static, 1)
+		for(size_t k = 0; k < searching; k++){
+			worker& w = workers[k];
+			w.root = roots[w.tree - &trees[0]];
+			w.check_interval = 1;
+			w.since_check = 0;
+			w.last_check = std::chrono::steady_clock::now();
+			while(keep_searching(w))
+				iterate(w, w.root, 0, state);
+		}
+		// the rate is doubled instead of measured if the pool runs out, since it is then underestimated
+		if (shared_tree()){
+			double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - search_time).count();
+			bool full = trees[0].pool.full();
+			trees[0].pool.unshare();
+			if (full == true){
+				slot_rate *= 2;
+				std::cerr << name() << ": the shared tree is full at " << trees[0].pool.size() << " slots" << std::endl;
+			} else if (elapsed > 0.01){
+				slot_rate = std::max((trees[0].pool.size() - reserved) / elapsed, 65536.0);
 			}
 		}
-		step_count = 36 - remain_empty / 2;
-
-		root->state = state;
-		root->node_who = (who == board::white ? board::black : board::white);
-		expand(root);
-		while(total_time < 0.95 * time_schedule[step_count]){
-			Node* greedy_node;
-			greedy_node = select(root);
-			expand(greedy_node);
-			winner = simulation(greedy_node);
-			//std::cout<<winner<<std::endl;
-			total_visit_count = total_visit_count + 1;
-			backpropogation(root, greedy_node, winner, total_visit_count);
-			end_time = clock();
-			total_time = (double)(end_time - start_time)/CLOCKS_PER_SEC;
-		}
-		action result = greedy_select(root);
-		delete_tree(root);
-		free(root);
+		if (report == true){
+			double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+			int iterations = 0;
+			size_t nodes = 0, slots = 0;
+			for(size_t k = 0; k < trees.size(); k++){
+				iterations += trees[k].pool.visit_count[roots[k]] - trees[k].root_visits;
+				nodes += trees[k].pool.nodes();
+				slots += trees[k].pool.size();
+			}
+			iterations /= playouts;
+			std::cerr << name() << ": " << iterations << " iterations, " << nodes << " nodes in " << slots << " slots, " << elapsed << " s, "
+			          << int(iterations / std::max(elapsed, 1e-9)) << " iterations/s" << std::endl;
+		}
+		action result = greedy_select(roots, state);
+		last_state = state;
+		last_root = roots[0];
+		last_move = (result.type() == action::place::type ? action::place(result).position().i : -1);
+		timer.stop();
 		return result;
 	}
 private:
-	double time_schedule[36] = {0.2, 0.2, 0.2, 0.4, 0.4, 0.4,
-								0.7, 0.7, 0.7, 1.4, 1.4, 1.4,
-						 		1.7, 1.7, 1.7, 2.0, 2.0, 2.0,
-						 		1.7, 1.7, 1.7, 1.7, 1.7, 1.7,
-						 		1.0, 1.0, 1.0, 0.5, 0.5, 0.5,
-						 		0.4, 0.4, 0.4, 0.2, 0.2, 0.2 };
-	int step_count = 0;
-	std::vector<action::place> white_space;
-	std::vector<action::place> black_space;
 	board::piece_type who;
+	double budget = 34; // the main time of a game in seconds
+	double default_budget = 34; // the main time given by budget=, which is taken without a time limit from GTP
+	double period_time = 0; // the time of a byo-yomi period in seconds
+	int period_stones = 0; // the moves of a byo-yomi period, or 0 without byo-yomi
+	time_manager timer;
+	int iteration_limit = 0; // the iterations of a search, or 0 for no limit
+	size_t node_limit = 0; // the nodes of a search tree, or 0 for no limit
+	double time_limit = 0; // the time of a search in seconds, or 0 for the time manager
+	int searched = 0; // the iterations of the current search, counted only with iteration_limit
+	bool report = false;
+	endgame_solver solver;
+	int solve_threshold = 20; // the solver is used when fewer points than this are left for either side, or never if 0
+	size_t solve_nodes = 1 << 21; // the positions searched by the solver for a move at most
+
+	std::vector<search_tree> trees;
+	std::vector<worker> workers = std::vector<worker>(1);
+	bool leaf_parallel = false;
+	int playouts = 1; // the playouts run from each selected leaf
+	int expand_threshold = 2; // the visits of a leaf before its children are reserved
+	bool reuse = true;
+	board last_state;
+	node_pool::node last_root = 0;
+	int last_move = -1;
+	bool ponder = false;
+	std::atomic<bool> pondering{false};
+	std::thread thinker;
+	static constexpr size_t pool_limit = size_t(1) << 23; // the pool size to stop pondering, or of a shared tree at most
+	double slot_rate = 1 << 20; // the slots reserved per second by the last shared search
 };
 
 
@@ -15,6 +15,7 @@
 #include <algorithm>
 #include <utility>
 #include <cmath>
+#include <cstdint>
 
 /**
  * definition for the 9x9 board
@@ -41,6 +42,9 @@
  *
  * for 9x9 Hollow NoGo, the center 3x3 is hollow (hollow but not empty, cannot be counted as liberty),
  * i.e., there are also borders at the center of the board
+ *
+ * the position is stored as bitboards, one 128-bit mask per piece type,
+ * where bit (i) of a mask is the 1-d array style position (i)
  */
 class board {
 public:
@@ -49,14 +53,18 @@ public:
 	typedef uint32_t cell;
 	typedef std::array<cell, size_y> column;
 	typedef std::array<column, size_x> grid;
+	typedef unsigned __int128 mask;
 	struct data {
 		piece_type who_take_turns;
 	};
 	typedef int reward;
 
 public:
-	board() : stone(initial()), attr({piece_type::black}) {}
-	board(const grid& b, const data& d) : stone(b), attr(d) {}
+	board() : stone{0, 0, hollow_scheme()}, attr({piece_type::black}) { rebuild(); }
+	board(const grid& b, const data& d) : stone{0, 0, 0}, attr(d) {
+		for (unsigned i = 0; i < size_x * size_y; i++) set(i, b[i / size_y][i % size_y]);
+		rebuild();
+	}
 	board(const board& b) = default;
 	board& operator =(const board& b) = default;
 
@@ -76,21 +84,85 @@ public:
 		}
 	};
 
-	operator grid&() { return stone; }
-	operator const grid&() const { return stone; }
-	column& operator [](unsigned x) { return stone[x]; }
-	const column& operator [](unsigned x) const { return stone[x]; }
-	cell& operator ()(unsigned i) { point p(i); return stone[p.x][p.y]; }
-	const cell& operator ()(unsigned i) const { point p(i); return stone[p.x][p.y]; }
-	cell& operator ()(const std::string& move) { point p(move); return stone[p.x][p.y]; }
-	const cell& operator ()(const std::string& move) const { point p(move); return stone[p.x][p.y]; }
+	/**
+	 * proxies for accessing the bitboards as if they were a 2-d array of cells
+	 */
+	class cell_ref {
+	public:
+		cell_ref(board& b, unsigned i) : b(b), i(i) {}
+		cell_ref(const cell_ref&) = default;
+		operator cell() const { return b.get(i); }
+		cell_ref& operator =(cell c) { b.set(i, c); b.rebuild(); return *this; }
+		cell_ref& operator =(const cell_ref& c) { return operator =(cell(c)); }
+	private:
+		board& b;
+		unsigned i;
+	};
+	class column_ref {
+	public:
+		column_ref(board& b, unsigned x) : b(b), x(x) {}
+		cell_ref operator [](unsigned y) const { return cell_ref(b, x * size_y + y); }
+	private:
+		board& b;
+		unsigned x;
+	};
+	class const_column_ref {
+	public:
+		const_column_ref(const board& b, unsigned x) : b(b), x(x) {}
+		cell operator [](unsigned y) const { return b.get(x * size_y + y); }
+	private:
+		const board& b;
+		unsigned x;
+	};
+
+	operator grid() const {
+		grid g;
+		for (unsigned i = 0; i < size_x * size_y; i++) g[i / size_y][i % size_y] = get(i);
+		return g;
+	}
+	column_ref operator [](unsigned x) { return column_ref(*this, x); }
+	const_column_ref operator [](unsigned x) const { return const_column_ref(*this, x); }
+	cell_ref operator ()(unsigned i) { return cell_ref(*this, i); }
+	cell operator ()(unsigned i) const { return get(i); }
+	cell_ref operator ()(const std::string& move) { return cell_ref(*this, point(move).i); }
+	cell operator ()(const std::string& move) const { return get(point(move).i); }
 
 	data info() const { return attr; }
 	data info(data dat) { data old = attr; attr = dat; return old; }
 
+	/**
+	 * the 64-bit Zobrist key of the position, including the side to move
+	 */
+	uint64_t hash() const {
+		return key ^ (attr.who_take_turns == piece_type::white ? zobrist()[0] : 0);
+	}
+	/**
+	 * the key of the position after who places at the empty point (i), without placing it
+	 */
+	uint64_t hash(unsigned i, unsigned who) const {
+		return key ^ zobrist()[i * 2 + who] ^ (who == piece_type::black ? zobrist()[0] : 0);
+	}
+
+	/**
+	 * the bitboard of the given piece type
+	 */
+	mask stones(unsigned who) const {
+		switch (who) {
+		case piece_type::black:  return stone.black;
+		case piece_type::white:  return stone.white;
+		case piece_type::hollow: return stone.hollow;
+		case piece_type::empty:  return full() & ~(stone.black | stone.white | stone.hollow);
+		default:                 return 0;
+		}
+	}
+
 public:
-	bool operator ==(const board& b) const { return stone == b.stone; }
-	bool operator < (const board& b) const { return stone <  b.stone; }
+	bool operator ==(const board& b) const { return stone.black == b.stone.black && stone.white == b.stone.white && stone.hollow == b.stone.hollow; }
+	bool operator < (const board& b) const {
+		if (stone.black != b.stone.black) return stone.black < b.stone.black;
+		if (stone.white != b.stone.white) return stone.white < b.stone.white;
+		return stone.hollow < b.stone.hollow;
+	}
 	bool operator !=(const board& b) const { return !(*this == b); }
 	bool operator > (const board& b) const { return b < *this; }
 	bool operator <=(const board& b) const { return !(b < *this); }
@@ -118,81 +190,85 @@ public:
 		if (x == -1 && y == -1) return nogo_move_result::illegal_pass;
 		point p_min(0, 0), p_max(size_x - 1, size_y - 1);
 		if (x < p_min.x || x > p_max.x || y < p_min.y || y > p_max.y) return nogo_move_result::illegal_out_of_range;
-		if (board::initial()[x][y] == piece_type::hollow)             return nogo_move_result::illegal_out_of_range;
-		board test = *this;
-		if (test[x][y] != piece_type::empty) return nogo_move_result::illegal_not_empty;
-		test[x][y] = who; // try put a piece first
-		if (test.check_liberty(x, y, who) == 0) return nogo_move_result::illegal_suicide;
-		unsigned opp = 3u - who;
-		if (x > p_min.x && test.check_liberty(x - 1, y, opp) == 0) return nogo_move_result::illegal_take;
-		if (x < p_max.x && test.check_liberty(x + 1, y, opp) == 0) return nogo_move_result::illegal_take;
-		if (y > p_min.y && test.check_liberty(x, y - 1, opp) == 0) return nogo_move_result::illegal_take;
-		if (y < p_max.y && test.check_liberty(x, y + 1, opp) == 0) return nogo_move_result::illegal_take;
-		stone[x][y] = who; // is legal move!
-		attr.who_take_turns = static_cast<piece_type>(opp);
+		unsigned i = point(x, y).i;
+		if (bit(i) & hollow_scheme())                            return nogo_move_result::illegal_out_of_range;
+		if (bit(i) & (stone.black | stone.white | stone.hollow)) return nogo_move_result::illegal_not_empty;
+		reward result = check_place(i, who);
+		if (result != nogo_move_result::legal) return result;
+		put(i, who); // is legal move!
+		attr.who_take_turns = static_cast<piece_type>(3u - who);
 		return nogo_move_result::legal;
 	}
 	reward place(const point& p, unsigned who = piece_type::unknown) {
 		return place(p.x, p.y, who);
 	}
 
+	/**
+	 * place a piece of who at the point (i), which must be one of legal_moves(who), without any check
+	 * this is meant for playouts, where the moves are drawn from the legal sets
+	 */
+	void play(unsigned i, unsigned who) {
+		put(i, who);
+		attr.who_take_turns = static_cast<piece_type>(3u - who);
+	}
+
 	/**
 	 * calculate the liberty of the block of piece at [x][y]
 	 * return >= 0 if [x][y] is placed by who; otherwise return -1
 	 */
 	int check_liberty(int x, int y, unsigned who) const {
-		grid test = stone;
-		if (test[x][y] != who) return -1;
-
-		int liberty = 0;
-		std::list<point> check;
-		for (check.emplace_back(x, y); check.size(); check.pop_front()) {
-			int x = check.front().x, y = check.front().y;
-			test[x][y] = piece_type::unknown; // prevent recalculate
-
-			point p_min(0, 0), p_max(size_x - 1, size_y - 1);
-
-			cell near_l = x > p_min.x ? test[x - 1][y] : -1u; // left
-			if (near_l == piece_type::empty) liberty++;
-			else if (near_l == who) check.emplace_back(x - 1, y);
-
-			cell near_r = x < p_max.x ? test[x + 1][y] : -1u; // right
-			if (near_r == piece_type::empty) liberty++;
-			else if (near_r == who) check.emplace_back(x + 1, y);
+		mask m = bit(point(x, y).i);
+		if (get(point(x, y).i) != who) return -1;
+		return popcount(neighbors(flood(m, stones(who))) & stones(piece_type::empty));
+	}
 
-			cell near_d = y > p_min.y ? test[x][y - 1] : -1u; // down
-			if (near_d == piece_type::empty) liberty++;
-			else if (near_d == who) check.emplace_back(x, y - 1);
+	/**
+	 * the pseudo-liberty of the block of the stone at (i), see libs
+	 */
+	unsigned liberty(unsigned i) const {
+		return libs[block[i]];
+	}
 
-			cell near_u = y < p_max.y ? test[x][y + 1] : -1u; // up
-			if (near_u == piece_type::empty) liberty++;
-			else if (near_u == who) check.emplace_back(x, y + 1);
+	/**
+	 * check whether who can place at the empty point (i), i.e., whether it is neither suicide nor taking
+	 * this only looks at the neighbors of (i) and the liberties tracked for their blocks
+	 * return nogo_move_result::legal, nogo_move_result::illegal_suicide, or nogo_move_result::illegal_take
+	 */
+	reward check_place(unsigned i, unsigned who) const {
+		unsigned near[4], n = adjacent(i, near);
+		mask own = stones(who), opp = stones(3u - who), space = stones(piece_type::empty);
+		bool alive = false;
+		for (unsigned k = 0; k < n && !alive; k++) {
+			mask m = bit(near[k]);
+			if (m & space) alive = true;
+			else if (m & own) alive = libs[block[near[k]]] > touch(near, n, block[near[k]]);
+		}
+		if (!alive) return nogo_move_result::illegal_suicide;
+		for (unsigned k = 0; k < n; k++) {
+			if ((bit(near[k]) & opp) && libs[block[near[k]]] == touch(near, n, block[near[k]]))
+				return nogo_move_result::illegal_take;
 		}
-		return liberty;
+		return nogo_move_result::legal;
+	}
+
+	/**
+	 * the points where who can place, regardless of whose turn it is
+	 * the sets of both sides are maintained by place incrementally
+	 */
+	mask legal_moves(unsigned who) const {
+		return who == piece_type::black ? movable.black : movable.white;
 	}
 
 	void transpose() {
-		for (int x = 0; x < size_x; x++) {
-			for (int y = x + 1; y < size_y; y++) {
-				std::swap(stone[x][y], stone[y][x]);
-			}
-		}
+		permute([](int x, int y) { return point(y, x); });
 	}
 
 	void reflect_horizontal() {
-		for (int y = 0; y < size_y; y++) {
-			for (int x = 0; x < size_x / 2; x++) {
-				std::swap(stone[x][y], stone[size_x - 1 - x][y]);
-			}
-		}
+		permute([](int x, int y) { return point(size_x - 1 - x, y); });
 	}
 
 	void reflect_vertical() {
-		for (int x = 0; x < size_x; x++) {
-			for (int y = 0; y < size_y / 2; y++) {
-				std::swap(stone[x][y], stone[x][size_y - 1 - y]);
-			}
-		}
+		permute([](int x, int y) { return point(x, size_y - 1 - y); });
 	}
 
 	/**
@@ -212,6 +288,46 @@ public:
 	void rotate_left() { transpose(); reflect_horizontal(); } // counterclockwise
 	void reverse() { reflect_horizontal(); reflect_vertical(); }
 
+public:
+	static constexpr mask bit(unsigned i) { return mask(1) << i; }
+	static constexpr mask full() { return bit(size_x * size_y) - 1; }
+
+	/**
+	 * the points adjacent to any point of the given mask
+	 */
+	static mask neighbors(mask m) {
+		return ((m << size_y) | (m >> size_y) | ((m & ~edge(size_y - 1)) << 1) | ((m & ~edge(0)) >> 1)) & full();
+	}
+
+	/**
+	 * the connected block(s) of the given mask that contain the seed points
+	 */
+	static mask flood(mask seed, mask within) {
+		mask block = seed & within, last;
+		do {
+			last = block;
+			block |= neighbors(block) & within;
+		} while (block != last);
+		return block;
+	}
+
+	static int popcount(mask m) {
+		return __builtin_popcountll(uint64_t(m)) + __builtin_popcountll(uint64_t(m >> 64));
+	}
+	static unsigned lowest(mask m) {
+		return uint64_t(m) ? __builtin_ctzll(uint64_t(m)) : 64 + __builtin_ctzll(uint64_t(m >> 64));
+	}
+	/**
+	 * the point of the n-th (from 0) lowest bit of the mask, where n < popcount(m)
+	 */
+	static unsigned nth(mask m, unsigned n) {
+		unsigned low = __builtin_popcountll(uint64_t(m));
+		unsigned base = n < low ? 0 : 64;
+		uint64_t half = n < low ? uint64_t(m) : uint64_t(m >> 64);
+		for (n -= (base ? low : 0); n; n--) half &= half - 1;
+		return base + __builtin_ctzll(half);
+	}
+
 public:
 	friend std::ostream& operator <<(std::ostream& out, const board& b) {
 		std::ios ff(nullptr);
@@ -273,15 +389,211 @@ public:
 	}
 
 protected:
-	static const grid& initial() { static grid stone; return stone; }
-	static __attribute__((constructor)) void init_initial_scheme() {
-		grid& stone = const_cast<grid&>(initial());
-		point hollow((size_x - hollow_x) / 2, (size_y - hollow_y) / 2);
-		for (int x = hollow.x; x < hollow.x + hollow_x; x++)
-			for (int y = hollow.y; y < hollow.y + hollow_y; y++)
-				stone[x][y] = piece_type::hollow;
+	static constexpr mask edge(unsigned y, unsigned x = 0) {
+		return x < size_x ? bit(x * size_y + y) | edge(y, x + 1) : 0;
+	}
+	static constexpr mask area(unsigned x, unsigned y, unsigned w, unsigned h) {
+		return w ? (((mask(1) << h) - 1) << (x * size_y + y)) | area(x + 1, y, w - 1, h) : 0;
+	}
+	static constexpr mask hollow_scheme() {
+		return area((size_x - hollow_x) / 2, (size_y - hollow_y) / 2, hollow_x, hollow_y);
+	}
+
+	/**
+	 * the Zobrist keys, where [i * 2 + who] is for a stone of who at (i), and [0] is for white to move
+	 */
+	typedef std::array<uint64_t, size_x * size_y * 2 + 1> keys;
+	static const keys& zobrist() { static keys table; return table; }
+	static __attribute__((constructor)) void init_zobrist_keys() {
+		keys& table = const_cast<keys&>(zobrist());
+		uint64_t seed = 0;
+		for (uint64_t& k : table) { // splitmix64
+			uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+			k = z ^ (z >> 31);
+		}
+	}
+
+	cell get(unsigned i) const {
+		mask m = bit(i);
+		if (stone.black & m)  return piece_type::black;
+		if (stone.white & m)  return piece_type::white;
+		if (stone.hollow & m) return piece_type::hollow;
+		return piece_type::empty;
+	}
+	void set(unsigned i, cell c) {
+		mask m = bit(i);
+		stone.black &= ~m;
+		stone.white &= ~m;
+		stone.hollow &= ~m;
+		if (c == piece_type::black)  stone.black |= m;
+		if (c == piece_type::white)  stone.white |= m;
+		if (c == piece_type::hollow) stone.hollow |= m;
+	}
+
+	/**
+	 * move every piece at [x][y] to the point given by where(x, y)
+	 */
+	template<typename mapping>
+	void permute(mapping where) {
+		board next = *this;
+		for (unsigned i = 0; i < size_x * size_y; i++) {
+			point p(i);
+			next.set(where(p.x, p.y).i, get(i));
+		}
+		stone = next.stone;
+		rebuild();
+	}
+
+	/**
+	 * store the points next to (i) into near, and return how many there are
+	 */
+	static unsigned adjacent(unsigned i, unsigned (&near)[4]) {
+		unsigned n = 0;
+		if (i >= size_y) near[n++] = i - size_y;
+		if (i < (size_x - 1) * size_y) near[n++] = i + size_y;
+		if (i % size_y != 0) near[n++] = i - 1;
+		if (i % size_y != size_y - 1) near[n++] = i + 1;
+		return n;
+	}
+
+	/**
+	 * the stones of the block rooted at (root), by walking its chain
+	 */
+	mask members(unsigned root) const {
+		mask m = 0;
+		unsigned j = root;
+		do { m |= bit(j); j = next[j]; } while (j != root);
+		return m;
+	}
+
+	/**
+	 * count how many of the given points belong to the block
+	 */
+	unsigned touch(const unsigned (&near)[4], unsigned n, unsigned root) const {
+		unsigned count = 0;
+		for (unsigned k = 0; k < n; k++) count += (block[near[k]] == root);
+		return count;
+	}
+
+	/**
+	 * put a stone of who at the empty point (i), and maintain the blocks and their liberties
+	 * the block containing (i) takes the root of its first neighboring block of the same color
+	 */
+	void put(unsigned i, unsigned who) {
+		mask& own = (who == piece_type::black) ? stone.black : stone.white;
+		unsigned near[4], n = adjacent(i, near);
+		mask space = stones(piece_type::empty) & ~bit(i);
+		unsigned liberty = 0;
+		for (unsigned k = 0; k < n; k++) {
+			mask m = bit(near[k]);
+			if (m & space) liberty++;
+			else if (m & (stone.black | stone.white)) libs[block[near[k]]]--;
+		}
+		unsigned root = i;
+		libs[i] = 0;
+		next[i] = i;
+		for (unsigned k = 0; k < n; k++) {
+			if (!(bit(near[k]) & own) || block[near[k]] == root) continue;
+			if (root == i) {
+				root = block[near[k]];
+			} else {
+				unsigned merged = block[near[k]], j = merged;
+				libs[root] += libs[merged];
+				do { block[j] = root; j = next[j]; } while (j != merged);
+				std::swap(next[root], next[merged]);
+			}
+		}
+		own |= bit(i);
+		block[i] = root;
+		libs[root] += liberty;
+		if (root != i) std::swap(next[root], next[i]);
+		key ^= zobrist()[i * 2 + who];
+
+		// only the liberties of the blocks touched by (i) may change their legality
+		mask touched = members(root), opp = stones(3u - who);
+		for (unsigned k = 0; k < n; k++) {
+			if (bit(near[k]) & opp) touched |= members(block[near[k]]);
+		}
+		mask dirty = (neighbors(touched) & space) | bit(i);
+		movable.black = (movable.black & ~dirty) | scan(piece_type::black, dirty & space);
+		movable.white = (movable.white & ~dirty) | scan(piece_type::white, dirty & space);
+	}
+
+	/**
+	 * find the points of the given empty points where who can place
+	 * an empty point with an empty neighbor and no adjacent opponent is always legal,
+	 * and the rest of them are checked by check_place
+	 */
+	mask scan(unsigned who, mask space) const {
+		mask check = space & (neighbors(stones(3u - who)) | ~neighbors(stones(piece_type::empty)));
+		mask legal = space & ~check;
+		for (; check; check &= check - 1) {
+			unsigned i = lowest(check);
+			if (check_place(i, who) == nogo_move_result::legal) legal |= bit(i);
+		}
+		return legal;
 	}
+
+	/**
+	 * recalculate all blocks and their liberties from the bitboards
+	 */
+	void rebuild() {
+		for (unsigned i = 0; i < size_x * size_y; i++) block[i] = next[i] = i;
+		libs.fill(0);
+		key = 0;
+		for (mask m = stone.black; m; m &= m - 1) key ^= zobrist()[lowest(m) * 2 + piece_type::black];
+		for (mask m = stone.white; m; m &= m - 1) key ^= zobrist()[lowest(m) * 2 + piece_type::white];
+		mask space = stones(piece_type::empty);
+		for (mask own : { stone.black, stone.white }) {
+			for (mask rest = own; rest; ) {
+				unsigned root = lowest(rest);
+				mask group = flood(bit(root), own);
+				rest &= ~group;
+				unsigned last = root;
+				for (mask m = group; m; m &= m - 1) {
+					unsigned j = lowest(m);
+					block[j] = root;
+					next[last] = j;
+					last = j;
+					libs[root] += popcount(neighbors(bit(j)) & space);
+				}
+				next[last] = root;
+			}
+		}
+		movable.black = scan(piece_type::black, space);
+		movable.white = scan(piece_type::white, space);
+	}
+
 private:
-	grid stone;
+	struct bitboard {
+		mask black, white, hollow;
+	};
+	bitboard stone;
 	data attr;
+
+	/**
+	 * the blocks and their liberties, which are maintained by place incrementally
+	 * block[i] is the root point of the block containing the stone at (i)
+	 * libs[r] is the number of (stone, adjacent empty point) pairs of the block rooted at (r),
+	 * i.e., the pseudo-liberty, which is zero if and only if the block has no liberty
+	 * next[i] is the next stone of the block containing the stone at (i), which chains the stones of a block in a cycle
+	 */
+	std::array<uint8_t, size_x * size_y> block;
+	std::array<uint8_t, size_x * size_y> libs;
+	std::array<uint8_t, size_x * size_y> next;
+
+	/**
+	 * the legal points of both sides, which are maintained by place incrementally
+	 */
+	struct legality {
+		mask black, white;
+	};
+	legality movable;
+
+	/**
+	 * the Zobrist key of the stones, which is maintained by place incrementally
+	 */
+	uint64_t key;
 };
@@ -86,21 +86,27 @@ int main(int argc, const char* argv[]) {
 			white.close_episode(win.name());
 		}
 	} else { // launch GTP shell
+		auto open_episode = [&]() { // open an episode if none is ongoing
+			if (!stat.is_episode_ongoing()) {
+				black.open_episode("~:" + white.name());
+				white.open_episode(black.name() + ":~");
+				stat.open_episode(black.name() + ":" + white.name());
+			}
+		};
 		for (std::string command; std::getline(std::cin, command); ) {
 			if (command.back() == '\r') command.pop_back();
 			if (command.empty()) continue;
+			black.stop_pondering();
+			white.stop_pondering();
 
 			std::vector<std::string> args;
 			std::istringstream iss(command);
 			for (std::string s; getline(iss, s, ' '); args.push_back(s));
 
 			std::string reply;
+			agent* thinker = nullptr; // the player who may ponder after replying
 			if (args[0] == "play" || args[0] == "genmove") { // play a move, or generate a move and play
-				if (!stat.is_episode_ongoing()) { // should open an episode
-					black.open_episode("~:" + white.name());
-					white.open_episode(black.name() + ":~");
-					stat.open_episode(black.name() + ":" + white.name());
-				}
+				open_episode();
 
 				episode& game = stat.back();
 				agent& who = game.take_turns(black, white);
@@ -139,6 +145,7 @@ int main(int argc, const char* argv[]) {
 					action::place move = who.take_action(game.state());
 					if (game.apply_action(move) == true) {
 						reply = move.position();
+						thinker = &who;
 					} else { // I have no legal move to play
 						reply = "resign";
 					}
@@ -153,6 +160,15 @@ int main(int argc, const char* argv[]) {
 				}
 				if (args[0] == "quit") break; // quit GTP shell
 
+			} else if (args[0] == "time_settings") { // set the time limits of both players
+				black.time_settings(std::stod(args[1]), std::stod(args[2]), std::stoi(args[3]));
+				white.time_settings(std::stod(args[1]), std::stod(args[2]), std::stoi(args[3]));
+
+			} else if (args[0] == "time_left") { // update the time left of a player
+				open_episode(); // the clock of a game is reset when it opens, so open it before the update
+				agent& who = (std::tolower(args[1][0]) == 'b') ? static_cast<agent&>(black) : static_cast<agent&>(white);
+				who.time_left(std::stod(args[2]), std::stoi(args[3]));
+
 			} else if (args[0] == "showboard") { // print the board
 				std::stringstream buf;
 				buf << (stat.is_episode_ongoing() ? stat.back().state() : board());
@@ -174,12 +190,14 @@ int main(int argc, const char* argv[]) {
 				reply = "2";
 			} else if (args[0] == "list_commands") { // print supported commands
 				reply = "play\n" "genmove\n" "clear_board\n" "showboard\n" "boardsize\n"
+				        "time_settings\n" "time_left\n"
 				        "name\n" "version\n" "protocol_version\n" "list_commands\n" "quit\n";
 			} else {
 				reply = "unknown command";
 			}
 
 			std::cout << "= " << reply << std::endl << std::endl;
+			if (thinker) thinker->start_pondering(stat.back().state());
 		}
 	}
 